@@ -0,0 +1,284 @@
+#include "Logger.hpp"
+#include "GLTools.hpp"
+#include "Graphics.hpp"
+#include "Camera.hpp"
+#include "Resources.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+// Self-contained microbenchmarks for the CPU side of the engine (no GL context or map install needed).
+// With --compare, any benchmark slower than its baseline by more than the tolerance (default 10%),
+// or allocating more per op, is reported as a regression and the exit code is 1.
+
+static std::atomic<uint64_t> alloc_count{ 0 }, alloc_bytes{ 0 };
+
+// Kept out of line, or GCC sees the malloc/free pair through inlined containers and reports mismatched-new-delete.
+#if defined(_MSC_VER)
+	#define BENCH_NOINLINE __declspec(noinline)
+#else
+	#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+BENCH_NOINLINE void *operator new(size_t size) {
+	alloc_count.fetch_add(1, std::memory_order_relaxed);
+	alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+	if (void *ptr = std::malloc(size ? size : 1)) return ptr;
+	throw std::bad_alloc{};
+}
+BENCH_NOINLINE void operator delete(void *ptr) noexcept {
+	std::free(ptr);
+}
+BENCH_NOINLINE void operator delete(void *ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+struct Result {
+	std::string name;
+	double ns_per_op, bytes_per_sec, allocs_per_op, alloc_bytes_per_op;
+};
+static std::vector<Result> results;
+// Results go through their own stream so benchmarks can silence std::cout.
+static std::ostream report{ std::cout.rdbuf() };
+static const char *filter = nullptr;
+static double min_time = 0.5;
+const int SAMPLES = 5;
+
+static volatile float float_sink;
+static volatile uintptr_t ptr_sink;
+
+typedef std::chrono::steady_clock bench_clock;
+template <typename F>
+static double time_batch(F &op, uint64_t iterations) {
+	const bench_clock::time_point start = bench_clock::now();
+	for (uint64_t i = 0; i < iterations; ++i) op();
+	return std::chrono::duration<double>(bench_clock::now() - start).count();
+}
+
+// Runs op in batches long enough to time reliably and records the median of SAMPLES batches.
+template <typename F>
+static void bench(const std::string &name, size_t bytes_per_op, F &&op) {
+	if (filter && name.find(filter) == std::string::npos) return;
+	op();
+	uint64_t iterations = 1;
+	while (time_batch(op, iterations) < min_time / SAMPLES && iterations < (1ull << 32))
+		iterations *= 2;
+	double samples[SAMPLES];
+	const uint64_t start_count = alloc_count, start_bytes = alloc_bytes;
+	for (double &sample : samples)
+		sample = time_batch(op, iterations) * 1e9 / (double)iterations;
+	const double total_ops = (double)(iterations * SAMPLES);
+	const double allocs = (double)(alloc_count - start_count) / total_ops, bytes = (double)(alloc_bytes - start_bytes) / total_ops;
+	std::sort(samples, samples + SAMPLES);
+	const double ns = samples[SAMPLES / 2];
+	results.push_back({ name, ns, bytes_per_op ? (double)bytes_per_op * 1e9 / ns : 0.0, allocs, bytes });
+
+	const Result &result = results.back();
+	report << std::left << std::setw(32) << result.name << std::right << std::fixed << std::setprecision(1)
+		<< std::setw(14) << result.ns_per_op << " ns/op";
+	if (result.bytes_per_sec > 0.0) report << std::setw(12) << result.bytes_per_sec / (1024.0 * 1024.0) << " MiB/s";
+	else report << std::setw(18) << "";
+	report << std::setprecision(2) << std::setw(10) << result.allocs_per_op << " allocs/op"
+		<< std::setprecision(0) << std::setw(12) << result.alloc_bytes_per_op << " B/op" << std::endl;
+}
+
+// Vic2 terrain.bmp style file: 8-bit palette indices, land types below 64 and water above.
+static bool write_synthetic_bmp(const std::filesystem::path &path, glm::ivec2 dims) {
+	const uint32_t palette_size = 256 * 4, pixel_offset = 54 + palette_size, image_size = dims.x * dims.y;
+	uint8_t header[54] = { 'B', 'M' };
+	const auto put = [&header](size_t offset, uint32_t value) { std::memcpy(&header[offset], &value, sizeof(value)); };
+	put(2, pixel_offset + image_size);
+	put(10, pixel_offset);
+	put(14, 40);
+	put(18, dims.x);
+	put(22, dims.y);
+	header[26] = 1;
+	header[28] = 8;
+	put(34, image_size);
+	put(46, 256);
+	std::vector<uint8_t> data(pixel_offset + image_size);
+	std::memcpy(data.data(), header, sizeof(header));
+	for (uint32_t idx = 0; idx < 256; ++idx)
+		for (uint32_t c = 0; c < 3; ++c) data[54 + idx * 4 + c] = (uint8_t)idx;
+	for (int y = 0; y < dims.y; ++y)
+		for (int x = 0; x < dims.x; ++x)
+			data[pixel_offset + y * dims.x + x] = (x / 16 + y / 32) % 5 ? (uint8_t)((x / 8 + y / 8) % 64) : 254;
+	std::ofstream file{ path, std::ios::binary };
+	file.write((const char *)data.data(), data.size());
+	return (bool)file;
+}
+
+static void bench_bmp(glm::ivec2 dims) {
+	const std::filesystem::path path = std::filesystem::temp_directory_path()
+		/ ("map-engine-bench-" + std::to_string(dims.x) + "x" + std::to_string(dims.y) + ".bmp");
+	if (!write_synthetic_bmp(path, dims)) {
+		logger("Failed to write ", path.string());
+		return;
+	}
+	const std::string filepath = path.string();
+	bench("bmp_read/" + std::to_string(dims.x) + "x" + std::to_string(dims.y), dims.x * dims.y, [&filepath]() {
+		pixels_t pixels;
+		GLint width, height;
+		if (read_bmp_unpaletted(filepath.c_str(), pixels, width, height)) return;
+		ptr_sink = pixels[(size_t)width * height / 2];
+	});
+	// Tracked once outside the timed op, so the registry doesn't skew the loader's numbers
+	pixels_t pixels;
+	GLint width, height;
+	if (!read_bmp_unpaletted(filepath.c_str(), pixels, width, height)) {
+		Resources::track_cpu(pixels.get(), "bench bmp", (size_t)width * height);
+		Resources::untrack_cpu(pixels.get());
+	}
+	std::filesystem::remove(path);
+}
+
+// A fresh Grid per op, as every map load stages into a new one.
+static void bench_grid(glm::ivec2 map_dims) {
+	size_t bytes = 0;
+	{
+		Graphics::Grid grid;
+		Graphics::build_grid(map_dims, grid);
+		bytes = grid.verticies.size() * sizeof(glm::vec2);
+	}
+	bench("grid_build/" + std::to_string(map_dims.x) + "x" + std::to_string(map_dims.y), bytes, [map_dims]() {
+		Graphics::Grid grid;
+		Graphics::build_grid(map_dims, grid);
+		float_sink = grid.verticies[grid.verticies.size() / 2].x;
+	});
+}
+
+static void bench_camera(void) {
+	CameraFree camera_free{ { 0.0f, 1.0f, 5.0f }, { 0.0f, -0.2f, -1.0f } };
+	bench("camera_free/move", 0, [&camera_free]() {
+		camera_free.move({ 0.001f, 0.0f, -0.001f });
+		float_sink = camera_free.getMatrix()[3][0];
+	});
+	float sign = 1.0f;
+	bench("camera_free/rotate", 0, [&camera_free, &sign]() {
+		camera_free.rotate({ 0.001f * sign, 0.0005f * sign });
+		sign = -sign;
+		float_sink = camera_free.getMatrix()[3][0];
+	});
+	CameraRot camera_rot{ { 0.0f, 1.0f, 5.0f }, { 0.0f, -0.3f } };
+	bench("camera_rot/rotate", 0, [&camera_rot, &sign]() {
+		camera_rot.rotate({ 0.001f * sign, 0.0005f * sign });
+		sign = -sign;
+		float_sink = camera_rot.getMatrix()[3][0];
+	});
+}
+
+static void bench_logger(void) {
+	const char *filepath = R"(C:\Program Files (x86)\Steam\steamapps\common\Victoria 2\map\terrain\texturesheet.tga)";
+	bench("get_filename", std::strlen(filepath), [filepath]() {
+		ptr_sink = (uintptr_t)get_filename(filepath);
+	});
+
+	struct : std::streambuf {
+		int overflow(int c) override { return traits_type::not_eof(c); }
+		std::streamsize xsputn(const char *, std::streamsize count) override { return count; }
+	} null_buffer;
+	std::streambuf *const cout_buffer = std::cout.rdbuf(&null_buffer);
+	uint64_t fps = 59, tps = 60;
+	bench("logger/fps_line", 0, [&fps, &tps]() {
+		logger("FPS: ", fps, ", TPS: ", tps);
+	});
+	std::cout.rdbuf(cout_buffer);
+}
+
+static bool save_baseline(const char *path) {
+	std::ofstream file{ path };
+	file << std::setprecision(17);
+	for (const Result &result : results)
+		file << result.name << " " << result.ns_per_op << " " << result.allocs_per_op << "\n";
+	if (!file) {
+		logger("Failed to save baseline to ", path);
+		return false;
+	}
+	logger("Saved baseline of ", results.size(), " benchmarks to ", path);
+	return true;
+}
+
+// Returns the number of regressions, or -1 if the baseline could not be read.
+static int compare_baseline(const char *path, double tolerance) {
+	std::ifstream file{ path };
+	if (!file) {
+		logger("Failed to open baseline ", path);
+		return -1;
+	}
+	std::map<std::string, std::pair<double, double>> baseline;
+	std::string name;
+	double ns, allocs;
+	while (file >> name >> ns >> allocs)
+		baseline[name] = { ns, allocs };
+
+	int regressions = 0;
+	report << "\nComparison against " << path << " (tolerance " << std::setprecision(1) << tolerance * 100.0 << "%):\n";
+	for (const Result &result : results) {
+		const auto it = baseline.find(result.name);
+		if (it == baseline.end()) {
+			report << std::left << std::setw(32) << result.name << std::right << "  not in baseline\n";
+			continue;
+		}
+		const double change = result.ns_per_op / it->second.first - 1.0;
+		const bool slower = change > tolerance, more_allocs = result.allocs_per_op > it->second.second + 0.5;
+		report << std::left << std::setw(32) << result.name << std::right << std::showpos << std::setw(10)
+			<< change * 100.0 << "%" << std::noshowpos;
+		if (slower) report << "  REGRESSION (time)";
+		if (more_allocs) report << "  REGRESSION (allocs " << std::setprecision(2) << it->second.second
+			<< " -> " << result.allocs_per_op << std::setprecision(1) << ")";
+		report << "\n";
+		regressions += slower || more_allocs;
+	}
+	report << std::endl;
+	return regressions;
+}
+
+int main(int argc, char **argv) {
+	const char *save_path = nullptr, *compare_path = nullptr;
+	double tolerance = 0.1;
+	for (int idx = 1; idx < argc; ++idx) {
+		const std::string arg = argv[idx];
+		const bool has_value = idx + 1 < argc;
+		if (arg == "--filter" && has_value) filter = argv[++idx];
+		else if (arg == "--min-time" && has_value) min_time = std::atof(argv[++idx]);
+		else if (arg == "--save" && has_value) save_path = argv[++idx];
+		else if (arg == "--compare" && has_value) compare_path = argv[++idx];
+		else if (arg == "--tolerance" && has_value) tolerance = std::atof(argv[++idx]) / 100.0;
+		else {
+			std::cout << "Usage: " << argv[0] << " [--filter STR] [--min-time SECONDS] [--save FILE] [--compare FILE] [--tolerance PERCENT]" << std::endl;
+			return arg == "--help" ? 0 : -1;
+		}
+	}
+
+	bench_bmp({ 2048, 1024 });
+	bench_bmp({ 5616, 2160 });
+	bench_grid({ 2048, 1024 });
+	bench_grid({ 5616, 2160 });
+	bench_camera();
+	bench_logger();
+
+	const Resources::Usage usage = Resources::get_usage();
+	report << "\nPeak tracked CPU staging: " << std::setprecision(2) << (double)usage.cpu_peak / (1024.0 * 1024.0)
+		<< " MiB, still tracked: " << usage.cpu_bytes << " bytes" << std::endl;
+
+	if (save_path && !save_baseline(save_path)) return -1;
+	if (compare_path) {
+		const int regressions = compare_baseline(compare_path, tolerance);
+		if (regressions < 0) return -1;
+		if (regressions) {
+			logger(regressions, " benchmark(s) regressed against ", compare_path, ".");
+			return 1;
+		}
+		logger("No regressions against ", compare_path, ".");
+	}
+	return 0;
+}
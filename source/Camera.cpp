@@ -51,3 +51,22 @@ void CameraRot::updateMatrix(void) {
 	front = FORWARDS;
 	CameraFree::rotate(yaw_pitch);
 }
+
+CameraTopDown::CameraTopDown(void) : CameraTopDown{ glm::vec3{} } {}
+CameraTopDown::CameraTopDown(glm::vec3 position) : pos{ position }, yaw{ 0.0f } {
+	updateMatrix();
+}
+void CameraTopDown::move(glm::vec3 delta) {
+	pos += glm::rotate(delta, yaw, UP);
+	updateMatrix();
+}
+void CameraTopDown::rotate(glm::vec2 yaw_pitch_rads) {
+	yaw += yaw_pitch_rads.x;
+	updateMatrix();
+}
+void CameraTopDown::updateMatrix(void) {
+	matrix = glm::lookAt(pos, pos - UP, glm::rotate(FORWARDS, yaw, UP));
+}
+glm::mat4 CameraTopDown::getMatrix(void) const {
+	return matrix;
+}
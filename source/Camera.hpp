@@ -35,3 +35,18 @@ public:
 	void rotate(glm::vec2 yaw_pitch_rads) override;
 	void updateMatrix(void) override;
 };
+
+// Looks straight down the up vector, yaw turns the view about it.
+class CameraTopDown : public Camera {
+	glm::mat4 matrix;
+	glm::vec3 pos;
+	float yaw;
+public:
+	CameraTopDown(void);
+	CameraTopDown(glm::vec3 position);
+
+	void move(glm::vec3 delta) override;
+	void rotate(glm::vec2 yaw_pitch_rads) override;
+	void updateMatrix(void) override;
+	glm::mat4 getMatrix(void) const override;
+};
@@ -1,9 +1,15 @@
 #include "GLTools.hpp"
 
 #include "Logger.hpp"
+#include "Resources.hpp"
 
 #include "SOIL2.h"
 
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
 static const char *debug_type_name(GLenum type) {
@@ -101,6 +107,7 @@ int load_program(GLuint &program, const char *vertex_shader, const char *geometr
 	glDeleteShader(fragment_shader_id);
 	if (ret) {
 		program = program_id;
+		Resources::track_object(Resources::PROGRAM, program, "program");
 		return 0;
 	} else {
 		logger("Program linking failed.");
@@ -110,39 +117,135 @@ int load_program(GLuint &program, const char *vertex_shader, const char *geometr
 	}
 }
 
-int load_texture(const char *filepath, GLuint &tex_id, GLint &width, GLint &height, GLint min_filter, GLint mag_filter, unsigned soil_flags) {
+// SOIL reports results through an unsynchronised global, so loads (and reading the result) must not overlap.
+static std::mutex soil_mutex;
+
+int read_image(const char *filepath, pixels_t &pixels, GLint &width, GLint &height, bool invert_y) {
+	pixels.reset();
 	width = 0;
 	height = 0;
-	tex_id = SOIL_load_OGL_texture(filepath, SOIL_LOAD_AUTO, SOIL_CREATE_NEW_ID, soil_flags);
-	if (!tex_id) {
-		logger("Failed to load texture ", filepath);
+	int channels = 0;
+	uint8_t *data;
+	std::string result;
+	{
+		std::lock_guard<std::mutex> guard{ soil_mutex };
+		data = SOIL_load_image(filepath, &width, &height, &channels, SOIL_LOAD_RGBA);
+		if (!data) result = SOIL_last_result();
+	}
+	if (!data) {
+		logger("Failed to load image ", filepath, ": ", result);
+		width = 0;
+		height = 0;
 		return -1;
 	}
-	glBindTexture(GL_TEXTURE_2D, tex_id);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag_filter);
-	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
-	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
-	glBindTexture(GL_TEXTURE_2D, 0);
-
+	// Keep SOIL's buffer rather than copying it
+	pixels = pixels_t{ data, { SOIL_free_image_data } };
 	if (width <= 0 || height <= 0) {
-		logger("Invalid texture dims ", width, " x ", height, " for ", filepath);
-		glDeleteTextures(1, &tex_id);
-		tex_id = 0;
+		logger("Invalid image dims ", width, " x ", height, " for ", filepath);
+		pixels.reset();
 		width = 0;
 		height = 0;
 		return -1;
 	}
+	if (invert_y) {
+		const size_t row_size = (size_t)width * 4;
+		for (GLint y = 0; y < height / 2; ++y)
+			std::swap_ranges(&data[row_size * y], &data[row_size * (y + 1)], &data[row_size * (height - 1 - y)]);
+	}
+	return 0;
+}
+
+static void delete_pixels(uint8_t *pixels) {
+	delete[] pixels;
+}
+
+// Reverses the 4 rows of pixels within a DXT block.
+static void flip_dxt_block(uint8_t *block, GLenum format) {
+	if (format == GL_COMPRESSED_RGBA_S3TC_DXT3_EXT) {
+		// 4 bits of alpha per pixel, 2 bytes per row
+		std::swap(block[0], block[6]);
+		std::swap(block[1], block[7]);
+		std::swap(block[2], block[4]);
+		std::swap(block[3], block[5]);
+		block += 8;
+	} else if (format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) {
+		// 2 alpha endpoints then 3 bit indices, 12 bits per row
+		uint64_t indices = 0, flipped = 0;
+		memcpy(&indices, &block[2], 6);
+		for (int row = 0; row < 4; ++row)
+			flipped |= (indices >> (12 * row) & 0xFFF) << (12 * (3 - row));
+		memcpy(&block[2], &flipped, 6);
+		block += 8;
+	}
+	// 2 colour endpoints then 2 bit indices, 1 byte per row
+	std::swap(block[4], block[7]);
+	std::swap(block[5], block[6]);
+}
+
+const size_t DDS_HEADER = 128;
+const uint32_t DDS_MAGIC = 0x20534444, DDPF_ALPHAPIXELS = 0x1, DDPF_FOURCC = 0x4;
+int read_dds(const char *filepath, Image &image, bool invert_y) {
+	image = {};
+	FILE *file = nullptr;
+	int ret = fopen_s(&file, filepath, "rb");
+	if (ret || !file) {
+		logger("Failed to open ", filepath, " with code ", ret);
+		return -1;
+	}
+	uint8_t header[DDS_HEADER];
+	if (fread(header, DDS_HEADER, 1, file) != 1 || *(uint32_t *)&header[0] != DDS_MAGIC) {
+		logger("Failed to read DDS header of ", filepath);
+		fclose(file);
+		return -1;
+	}
+	const glm::ivec2 dims{ *(int32_t *)&header[16], *(int32_t *)&header[12] };
+	const uint32_t pixel_flags = *(uint32_t *)&header[80];
+	GLenum format = 0;
+	if (pixel_flags & DDPF_FOURCC) {
+		const uint32_t four_cc = *(uint32_t *)&header[84];
+		if (!memcmp(&four_cc, "DXT1", 4))
+			format = pixel_flags & DDPF_ALPHAPIXELS ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		else if (!memcmp(&four_cc, "DXT3", 4)) format = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+		else if (!memcmp(&four_cc, "DXT5", 4)) format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	}
+	if (!format || dims.x <= 0 || dims.y <= 0 || (invert_y && dims.y % 4)) {
+		fclose(file);
+		image.internal_format = GL_RGBA8;
+		image.format = GL_RGBA;
+		ret = read_image(filepath, image.pixels, image.dims.x, image.dims.y, invert_y);
+		image.bytes = ret ? 0 : (size_t)image.dims.x * image.dims.y * 4;
+		return ret;
+	}
+	const size_t block_bytes = format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT ? 8 : 16;
+	const size_t blocks_x = (dims.x + 3) / 4, blocks_y = (dims.y + 3) / 4, row_size = blocks_x * block_bytes;
+	// fread overwrites every byte, so skip zero-filling the buffer
+	image.pixels = pixels_t{ new uint8_t[row_size * blocks_y], { delete_pixels } };
+	if (fread(image.pixels.get(), row_size * blocks_y, 1, file) != 1) {
+		logger("Failed to read ", row_size * blocks_y, " bytes of DXT blocks from ", filepath);
+		image.pixels.reset();
+		fclose(file);
+		return -1;
+	}
+	fclose(file);
+	if (invert_y) {
+		uint8_t *const blocks = image.pixels.get();
+		for (size_t y = 0; y < blocks_y / 2; ++y)
+			std::swap_ranges(&blocks[row_size * y], &blocks[row_size * (y + 1)], &blocks[row_size * (blocks_y - 1 - y)]);
+		for (size_t offset = 0; offset < row_size * blocks_y; offset += block_bytes)
+			flip_dxt_block(&blocks[offset], format);
+	}
+	image.dims = dims;
+	image.internal_format = format;
+	image.bytes = row_size * blocks_y;
 	return 0;
 }
 
 const size_t BMP_HEADER = 54;
-int load_bmp_texture_unpaletted(const char *filepath, GLuint &tex_id, GLint &width, GLint &height, GLint min_filter, GLint mag_filter, unsigned soil_flags) {
-	tex_id = 0;
+
+int read_bmp_unpaletted(const char *filepath, pixels_t &pixels, GLint &width, GLint &height) {
+	pixels.reset();
 	width = 0;
 	height = 0;
-	if (soil_flags)
-		logger("soil_flags is not used here (value 0x", std::hex, soil_flags, ").");
 	FILE *file = nullptr;
 	int ret = fopen_s(&file, filepath, "rb");
 	if (ret || !file) {
@@ -172,26 +275,14 @@ int load_bmp_texture_unpaletted(const char *filepath, GLuint &tex_id, GLint &wid
 		fclose(file);
 		return -1;
 	}
-	uint8_t *pixels = new uint8_t[size];
-	if (fread(pixels, size, 1, file) != 1) {
+	// fread overwrites every byte, so skip zero-filling the buffer
+	pixels = pixels_t{ new uint8_t[size], { delete_pixels } };
+	if (fread(pixels.get(), size, 1, file) != 1) {
 		logger("Failed to read pixels (", size, " bytes at offset ", pixel_offset, ")");
-		delete[] pixels;
+		pixels.reset();
 		fclose(file);
 		return -1;
 	}
 	fclose(file);
-	glGenTextures(1, &tex_id);
-	if (!tex_id) {
-		logger("Failed to generated texture ID for ", filepath);
-		delete[] pixels;
-		return -1;
-	}
-	glBindTexture(GL_TEXTURE_2D, tex_id);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, pixels);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag_filter);
-	glBindTexture(GL_TEXTURE_2D, 0);
-
-	delete[] pixels;
 	return 0;
 }
@@ -1,10 +1,35 @@
 #pragma once
 
 #include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Decoded pixels, freed by whatever allocated them (operator new[] or SOIL).
+struct pixels_deleter_t {
+	void (*free_func)(uint8_t *pixels);
+	void operator()(uint8_t *pixels) const { free_func(pixels); }
+};
+typedef std::unique_ptr<uint8_t[], pixels_deleter_t> pixels_t;
+// Pixels ready for upload. Block compressed images have no format and go through glCompressedTex(Sub)Image2D.
+struct Image {
+	pixels_t pixels;
+	glm::ivec2 dims;
+	GLenum internal_format, format;
+	size_t bytes;
+};
 
 void enable_gl_debug_output(void);
 int load_shader(GLenum shader_type, GLuint &shader, const char *source);
 int load_program(GLuint &program, const char *vertex_shader, const char *geometry_shader, const char *fragment_shader);
 
-int load_texture(const char *filepath, GLuint &tex_id, GLint &width, GLint &height, GLint min_filter, GLint mag_filter, unsigned soil_flags);
-int load_bmp_texture_unpaletted(const char *filepath, GLuint &tex_id, GLint &width, GLint &height, GLint min_filter, GLint mag_filter, unsigned soil_flags);
+// Decodes any image SOIL supports into tightly packed RGBA8 pixels, without touching GL.
+// Safe to call from several threads, though the SOIL decodes themselves run one at a time.
+int read_image(const char *filepath, pixels_t &pixels, GLint &width, GLint &height, bool invert_y);
+// Reads the top level of a DXT1/3/5 DDS as blocks, without touching GL or decompressing them. Any other DDS
+// (or a flipped one whose height isn't a multiple of 4) is decoded to RGBA8 with read_image instead.
+int read_dds(const char *filepath, Image &image, bool invert_y);
+// Reads the raw (palette index) pixel bytes of an 8-bit BMP, without touching GL.
+int read_bmp_unpaletted(const char *filepath, pixels_t &pixels, GLint &width, GLint &height);
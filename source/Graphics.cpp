@@ -3,45 +3,259 @@
 #include "Logger.hpp"
 #include "GLTools.hpp"
 #include "Camera.hpp"
+#include "Resources.hpp"
+#include "TileCache.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
-#include <SOIL2.h>
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "map_vert.glsl"
 #include "map_frag.glsl"
+#include "view_vert.glsl"
+#include "view_frag.glsl"
 
-#define MAP_DIR R"(C:\Program Files (x86)\Steam\steamapps\common\Victoria 2\map)"
-
-typedef int (*load_texture_func_t)(const char *filepath, GLuint &tex_id, GLint &width, GLint &height, GLint min_filter, GLint mag_filter, unsigned soil_flags);
+typedef int (*read_texture_func_t)(const char *filepath, Image &image, bool invert_y);
 struct Texture {
-	const char *filepath, *uniform;
-	load_texture_func_t load_texture_func;
-	GLuint filter, soil_flags, id;
+	const char *filename, *uniform;
+	read_texture_func_t read_texture_func;
+	GLint filter;
+	bool invert_y;
+	GLuint id;
+	GLenum internal_format;
 	glm::ivec2 dims;
 	float aspect_ratio;
 };
+static int read_bmp(const char *filepath, Image &image, bool invert_y) {
+	if (invert_y)
+		logger("invert_y is not supported for BMPs (", filepath, ").");
+	image = { {}, { 0, 0 }, GL_R8, GL_RED, 0 };
+	if (read_bmp_unpaletted(filepath, image.pixels, image.dims.x, image.dims.y)) return -1;
+	image.bytes = (size_t)image.dims.x * image.dims.y;
+	return 0;
+}
+static int read_rgba(const char *filepath, Image &image, bool invert_y) {
+	image = { {}, { 0, 0 }, GL_RGBA8, GL_RGBA, 0 };
+	if (read_image(filepath, image.pixels, image.dims.x, image.dims.y, invert_y)) return -1;
+	image.bytes = (size_t)image.dims.x * image.dims.y * 4;
+	return 0;
+}
+// Set before staging starts, DXT blocks are only kept compressed if the driver can sample them.
+static bool s3tc_supported = false;
+static int read_colormap(const char *filepath, Image &image, bool invert_y) {
+	return s3tc_supported ? read_dds(filepath, image, invert_y) : read_rgba(filepath, image, invert_y);
+}
 enum Assets : int {
 	TERRAIN, TEXTURESHEET, COLOURMAP, COLORMAP_WATER, ASSET_COUNT
 };
+// Paths are relative to the map directory.
 static Texture textures[ASSET_COUNT] = {
-	{ MAP_DIR "/terrain.bmp", "terrain_tex", load_bmp_texture_unpaletted, GL_NEAREST, 0, 0, { 0, 0 }, 0.0f },
-	{ MAP_DIR "/terrain/texturesheet.tga", "texturesheet_tex", load_texture, GL_LINEAR, 0, 0, { 0, 0 }, 0.0f },
-	{ MAP_DIR "/terrain/colormap.dds", "colormap_tex", load_texture, GL_LINEAR, SOIL_FLAG_INVERT_Y, 0, { 0, 0 }, 0.0f },
-	{ MAP_DIR "/terrain/colormap_water.dds", "colormap_water_tex", load_texture, GL_LINEAR, SOIL_FLAG_INVERT_Y, 0, { 0, 0 }, 0.0f },
+	{ "terrain.bmp", "terrain_tex", read_bmp, GL_NEAREST, false, 0, 0, { 0, 0 }, 0.0f },
+	{ "terrain/texturesheet.tga", "texturesheet_tex", read_rgba, GL_LINEAR, false, 0, 0, { 0, 0 }, 0.0f },
+	{ "terrain/colormap.dds", "colormap_tex", read_colormap, GL_LINEAR, true, 0, 0, { 0, 0 }, 0.0f },
+	{ "terrain/colormap_water.dds", "colormap_water_tex", read_colormap, GL_LINEAR, true, 0, 0, { 0, 0 }, 0.0f },
 };
+// View render targets are bound on the unit after the map's textures.
+const int VIEW_TEX_UNIT = ASSET_COUNT;
 const float MAP_SIZE = 20.0f, MAP_HEIGHT = -2.5f, TILE_SIZE = 1.0f;
-static int rows, indicies_per_row;
+const size_t TILE_CACHE_BUDGET = 64 * 1024 * 1024;
 
+using Graphics::GRID_LOD_COUNT, Graphics::GRID_LOD_FACTOR, Graphics::Grid;
 typedef glm::vec2 vertex_t;
-static GLuint program, vao, vbo;
-static glm::mat4 model, proj;
+static Grid grid;
+
+// A map decoded (and its grid generated, if the terrain dims changed) on worker threads, waiting to be committed.
+typedef std::chrono::steady_clock map_clock;
+struct StagedMap {
+	std::string map_dir;
+	struct {
+		Image image;
+		map_clock::time_point finished;
+	} textures[ASSET_COUNT];
+	Grid grid;
+	std::future<bool> tasks[ASSET_COUNT];
+	map_clock::time_point started;
+};
+static std::unique_ptr<StagedMap> pending_map;
+static std::string map_dir;
+// Incremented by each commit so views know to refit and redraw.
+static uint64_t map_generation = 0;
+
+static GLuint program, view_program, vao, vbo;
+static size_t vbo_size;
+static glm::mat4 model;
 static struct {
-	struct { GLint model, view, proj, draw_3D; } vert;
+	struct { GLint model, view, proj, uv_region, draw_3D; } vert;
 	struct { GLint textures[ASSET_COUNT], terrain_dims; } frag;
+	GLint view_tex;
 } uniforms;
-static bool draw_3D = true;
+static bool draw_3D = true, tile_cache_ready = false, use_tile_cache = false;
 
-bool Graphics::init(void) {
+static void draw_map_region(glm::vec4 uv_region, const glm::mat4 &view, const glm::mat4 &proj) {
+	glUseProgram(program);
+	glUniform4fv(uniforms.vert.uv_region, 1, &uv_region[0]);
+	glUniformMatrix4fv(uniforms.vert.view, 1, GL_FALSE, &view[0][0]);
+	glUniformMatrix4fv(uniforms.vert.proj, 1, GL_FALSE, &proj[0][0]);
+	glDrawArrays(GL_TRIANGLE_STRIP, grid.quad_first, 4);
+}
+
+void Graphics::build_grid(glm::ivec2 terrain_dims, Grid &out) {
+	const glm::vec2 tile_count{ ceil(glm::vec2{ terrain_dims } / TILE_SIZE + 0.5f) };
+	glm::ivec2 lod_tile_counts[GRID_LOD_COUNT];
+	out.quad_first = 0;
+	int vertex_count = 4;
+	for (int lod = 0, factor = 1; lod < GRID_LOD_COUNT; ++lod, factor *= GRID_LOD_FACTOR) {
+		lod_tile_counts[lod] = { ((int)tile_count.x + factor - 1) / factor, ((int)tile_count.y + factor - 1) / factor };
+		const int indicies_per_row = 2 * (lod_tile_counts[lod].x + 1);
+		out.lods[lod].firsts.resize(lod_tile_counts[lod].y);
+		out.lods[lod].counts.assign(lod_tile_counts[lod].y, indicies_per_row);
+		for (int y = 0; y < lod_tile_counts[lod].y; ++y)
+			out.lods[lod].firsts[y] = vertex_count + y * indicies_per_row;
+		vertex_count += indicies_per_row * lod_tile_counts[lod].y;
+	}
+	out.verticies.resize(vertex_count);
+	for (int lod = 0; lod < GRID_LOD_COUNT; ++lod)
+		generate_grid(lod_tile_counts[lod], out.verticies.data() + out.lods[lod].firsts[0]);
+	generate_grid({ 1, 1 }, out.verticies.data() + out.quad_first);
+}
+
+// Runs on a worker thread, so only reads the constant parts of textures[idx].
+static bool stage_texture(StagedMap &staged, int idx, glm::ivec2 current_terrain_dims) {
+	const Texture &tex = textures[idx];
+	auto &out = staged.textures[idx];
+	const std::string filepath = staged.map_dir + "/" + tex.filename;
+	if (tex.read_texture_func(filepath.c_str(), out.image, tex.invert_y)) {
+		logger("Failed to stage ", filepath);
+		out.image.pixels.reset();
+		return false;
+	}
+	Resources::track_cpu(out.image.pixels.get(), tex.filename, out.image.bytes);
+	if (idx == TERRAIN && out.image.dims != current_terrain_dims) {
+		Graphics::build_grid(out.image.dims, staged.grid);
+		Resources::track_cpu(staged.grid.verticies.data(), "map grid", staged.grid.verticies.size() * sizeof(vertex_t));
+	}
+	out.finished = map_clock::now();
+	return true;
+}
+
+static std::unique_ptr<StagedMap> start_staging(const char *dir) {
+	std::unique_ptr<StagedMap> staged = std::make_unique<StagedMap>();
+	staged->map_dir = dir;
+	staged->started = map_clock::now();
+	for (int idx = 0; idx < ASSET_COUNT; ++idx)
+		staged->tasks[idx] = std::async(std::launch::async, stage_texture, std::ref(*staged), idx, textures[TERRAIN].dims);
+	return staged;
+}
+
+// Waits for any unfinished tasks, returning whether they all succeeded.
+static bool finish_staging(StagedMap &staged) {
+	bool success = true;
+	for (std::future<bool> &task : staged.tasks)
+		if (task.valid()) success &= task.get();
+	return success;
+}
+static bool staging_ready(const StagedMap &staged) {
+	for (const std::future<bool> &task : staged.tasks)
+		if (task.wait_for(std::chrono::seconds{ 0 }) != std::future_status::ready) return false;
+	return true;
+}
+
+static void release_staging(StagedMap &staged) {
+	for (auto &tex : staged.textures) {
+		if (!tex.image.pixels) continue;
+		Resources::untrack_cpu(tex.image.pixels.get());
+		tex.image.pixels.reset();
+	}
+	if (!staged.grid.verticies.empty()) {
+		Resources::untrack_cpu(staged.grid.verticies.data());
+		staged.grid.verticies = {};
+	}
+}
+
+// Uploads a staged map on the GL thread, reusing textures and the grid buffer where the dims are unchanged.
+// Returns how many textures were reused.
+static int commit_map(StagedMap &staged) {
+	int reused = 0;
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int idx = 0; idx < ASSET_COUNT; ++idx) {
+		Texture &tex = textures[idx];
+		const Image &in = staged.textures[idx].image;
+		// Block compressed images have no format
+		const bool compressed = !in.format;
+		if (tex.id && tex.dims == in.dims && tex.internal_format == in.internal_format) {
+			glBindTexture(GL_TEXTURE_2D, tex.id);
+			if (compressed)
+				glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, in.dims.x, in.dims.y, in.internal_format, (GLsizei)in.bytes, in.pixels.get());
+			else
+				glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, in.dims.x, in.dims.y, in.format, GL_UNSIGNED_BYTE, in.pixels.get());
+			reused++;
+		} else {
+			if (!tex.id) glGenTextures(1, &tex.id);
+			glBindTexture(GL_TEXTURE_2D, tex.id);
+			if (compressed)
+				glCompressedTexImage2D(GL_TEXTURE_2D, 0, in.internal_format, in.dims.x, in.dims.y, 0, (GLsizei)in.bytes, in.pixels.get());
+			else
+				glTexImage2D(GL_TEXTURE_2D, 0, in.internal_format, in.dims.x, in.dims.y, 0, in.format, GL_UNSIGNED_BYTE, in.pixels.get());
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, tex.filter);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, tex.filter);
+			if (tex.dims != glm::ivec2{ 0 })
+				Resources::untrack(Resources::TEXTURE, tex.id);
+			Resources::track_texture(tex.id, tex.filename, in.internal_format, in.dims, 1);
+			tex.internal_format = in.internal_format;
+			tex.dims = in.dims;
+			tex.aspect_ratio = (float)tex.dims.x / (float)tex.dims.y;
+		}
+		logger("Loaded ", staged.map_dir, "/", tex.filename, " with dims ", tex.dims.x, " x ", tex.dims.y, " (aspect ratio ",
+			tex.aspect_ratio, compressed ? ", block compressed" : "", ").");
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	if (!staged.grid.verticies.empty()) {
+		const size_t verticies_size = staged.grid.verticies.size() * sizeof(vertex_t);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		if (verticies_size == vbo_size)
+			glBufferSubData(GL_ARRAY_BUFFER, 0, verticies_size, staged.grid.verticies.data());
+		else {
+			glBufferData(GL_ARRAY_BUFFER, verticies_size, staged.grid.verticies.data(), GL_STATIC_DRAW);
+			if (vbo_size)
+				Resources::untrack(Resources::BUFFER, vbo);
+			vbo_size = verticies_size;
+			Resources::track_buffer(vbo, "map grid", verticies_size);
+		}
+		Resources::untrack_cpu(staged.grid.verticies.data());
+		staged.grid.verticies = {};
+		std::swap(grid, staged.grid);
+	}
+
+	model = glm::scale(glm::mat4{1.0f}, {textures[TERRAIN].aspect_ratio * MAP_SIZE, 1.0f, MAP_SIZE});
+	model = glm::translate(model, { -0.5f, MAP_HEIGHT, -0.5f });
+	glUseProgram(program);
+	glUniformMatrix4fv(uniforms.vert.model, 1, GL_FALSE, &model[0][0]);
+	glUniform2f(uniforms.frag.terrain_dims, (float)textures[TERRAIN].dims.x, (float)textures[TERRAIN].dims.y);
+	for (int idx = 0; idx < ASSET_COUNT; ++idx) {
+		glActiveTexture(GL_TEXTURE0 + idx);
+		glBindTexture(GL_TEXTURE_2D, textures[idx].id);
+	}
+	// Leave the spare unit active so textures created later don't disturb the map's bindings.
+	glActiveTexture(GL_TEXTURE0 + VIEW_TEX_UNIT);
+
+	if (tile_cache_ready) {
+		TileCache::set_map(model, textures[TERRAIN].aspect_ratio);
+		glUseProgram(program);
+	}
+	release_staging(staged);
+	map_dir = staged.map_dir;
+	map_generation++;
+	return reused;
+}
+
+bool Graphics::init(const char *dir) {
 	if constexpr (ASSET_COUNT <= 0) {
 		logger("No assets to load.");
 		return false;
@@ -52,6 +266,12 @@ bool Graphics::init(void) {
 		return false;
 	}
 
+	// Decode assets while GL is being set up
+	s3tc_supported = GLEW_EXT_texture_compression_s3tc;
+	if (!s3tc_supported)
+		logger("S3TC is unsupported, DXT compressed textures will be decompressed.");
+	std::unique_ptr<StagedMap> staged = start_staging(dir);
+
 	enable_gl_debug_output();
 
 	glClearColor(0.0f, 0.5f, 1.0f, 1.0f);
@@ -67,98 +287,320 @@ bool Graphics::init(void) {
 	int ret = load_program(program, SHADER_VERT, nullptr, SHADER_FRAG);
 	if (ret) {
 		logger("Failed to load shaders.");
+		finish_staging(*staged);
+		release_staging(*staged);
+		return false;
+	}
+	ret = load_program(view_program, SHADER_VIEW_VERT, nullptr, SHADER_VIEW_FRAG);
+	if (ret) {
+		logger("Failed to load view shaders.");
+		Resources::untrack(Resources::PROGRAM, program);
+		glDeleteProgram(program);
+		finish_staging(*staged);
+		release_staging(*staged);
 		return false;
 	}
+	uniforms.view_tex = glGetUniformLocation(view_program, "view_tex");
 	uniforms.vert.model = glGetUniformLocation(program, "model");
 	uniforms.vert.view = glGetUniformLocation(program, "view");
 	uniforms.vert.proj = glGetUniformLocation(program, "proj");
+	uniforms.vert.uv_region = glGetUniformLocation(program, "uv_region");
 	uniforms.vert.draw_3D = glGetUniformLocation(program, "draw_3D");
 	for (int idx = 0; idx < ASSET_COUNT; ++idx)
 		uniforms.frag.textures[idx] = glGetUniformLocation(program, textures[idx].uniform);
 	uniforms.frag.terrain_dims = glGetUniformLocation(program, "terrain_dims");
 
-	// Load images
-	for (int idx = 0; idx < ASSET_COUNT; ++idx) {
-		Texture &tex = textures[idx];
-		if (tex.load_texture_func(tex.filepath, tex.id, tex.dims.x,
-			tex.dims.y, tex.filter, tex.filter, tex.soil_flags)) {
-			ret = 1;
-			break;
-		}
-		tex.aspect_ratio = (float)tex.dims.x / (float)tex.dims.y;
-		logger("Loaded ", tex.filepath, " with dims ", tex.dims.x, " x ", tex.dims.y, " (aspect ratio ", tex.aspect_ratio, ").");
-	}
-	if (ret) {
-		for (int idx = 0; idx < ASSET_COUNT; ++idx)
-			glDeleteTextures(1, &textures[idx].id);
-		glDeleteProgram(program);
-		return false;
-	}
-	model = glm::scale(glm::mat4{1.0f}, {textures[TERRAIN].aspect_ratio * MAP_SIZE, 1.0f, MAP_SIZE});
-	model = glm::translate(model, { -0.5f, MAP_HEIGHT, -0.5f });
+	glUseProgram(view_program);
+	glUniform1i(uniforms.view_tex, VIEW_TEX_UNIT);
+	glUseProgram(program);
+	glUniform4f(uniforms.vert.uv_region, 0.0f, 0.0f, 1.0f, 1.0f);
+	for (int idx = 0; idx < ASSET_COUNT; ++idx)
+		glUniform1i(uniforms.frag.textures[idx], idx);
+	glActiveTexture(GL_TEXTURE0 + VIEW_TEX_UNIT);
 
 	// Generate tris buffer and vao
 	glGenVertexArrays(1, &vao);
+	Resources::track_object(Resources::VERTEX_ARRAY, vao, "map grid");
 	glBindVertexArray(vao);
 	glGenBuffers(1, &vbo);
+	vbo_size = 0;
 	glBindBuffer(GL_ARRAY_BUFFER, vbo);
 	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(vertex_t), (void *)0);
 	glEnableVertexAttribArray(0);
 
-	glUseProgram(program);
-	glUniformMatrix4fv(uniforms.vert.model, 1, GL_FALSE, &model[0][0]);
-	for (int idx = 0; idx < ASSET_COUNT; ++idx) {
-		glActiveTexture(GL_TEXTURE0 + idx);
-		glBindTexture(GL_TEXTURE_2D, textures[idx].id);
-		glUniform1i(uniforms.frag.textures[idx], idx);
+	if (!finish_staging(*staged)) {
+		logger("Failed to load map from ", dir);
+		release_staging(*staged);
+		glDeleteBuffers(1, &vbo);
+		Resources::untrack(Resources::VERTEX_ARRAY, vao);
+		glDeleteVertexArrays(1, &vao);
+		Resources::untrack(Resources::PROGRAM, program);
+		glDeleteProgram(program);
+		Resources::untrack(Resources::PROGRAM, view_program);
+		glDeleteProgram(view_program);
+		return false;
 	}
-	const glm::vec2 map_dims{ (float)textures[TERRAIN].dims.x, (float)textures[TERRAIN].dims.y };
-	glUniform2f(uniforms.frag.terrain_dims, map_dims.x, map_dims.y);
+	commit_map(*staged);
+	logger("Loaded map from ", dir, " in ", std::chrono::duration<double, std::milli>(map_clock::now() - staged->started).count(), " ms.");
 
-	const glm::vec2 tile_count{ ceil(map_dims / TILE_SIZE + 0.5f) };
-	const glm::vec2 tile_dims{ 1.0f / tile_count };
-	const glm::ivec2 tile_counti{ (int)tile_count.x, (int)tile_count.y };
-	indicies_per_row = 2 * (tile_counti.x + 1);
-	rows = tile_counti.y;
-	vertex_t *verticies = new vertex_t[indicies_per_row * tile_counti.y];
+	tile_cache_ready = use_tile_cache = TileCache::init(TILE_CACHE_BUDGET, draw_map_region, grid.quad_first, VIEW_TEX_UNIT);
+	if (tile_cache_ready)
+		TileCache::set_map(model, textures[TERRAIN].aspect_ratio);
+	else
+		logger("Failed to initialise the tile cache, the flat map will always be drawn directly.");
+	glUseProgram(program);
+
+	Resources::log_summary();
+	logger("Successfully initialised graphics.");
+	return true;
+}
+
+void Graphics::generate_grid(glm::ivec2 tile_count, glm::vec2 *verticies) {
+	const glm::vec2 tile_dims{ 1.0f / glm::vec2{ tile_count } };
 	int pos = 0;
-	for (int y = 0; y < tile_counti.y; ++y)
-		for (int x = 0; x < tile_counti.x + 1; ++x) {
+	for (int y = 0; y < tile_count.y; ++y)
+		for (int x = 0; x < tile_count.x + 1; ++x) {
 			verticies[pos++] = { (float)x * tile_dims.x, (float)y * tile_dims.y };
 			verticies[pos++] = { (float)x * tile_dims.x, (float)(y + 1) * tile_dims.y };
 		}
-
-	glBufferData(GL_ARRAY_BUFFER, indicies_per_row * tile_counti.y * sizeof(vertex_t), verticies, GL_STATIC_DRAW);
-	delete[] verticies;
-
-	logger("Successfully initialised graphics.");
-	return true;
 }
 
 void Graphics::deinit(void) {
+	if (pending_map) {
+		logger("Abandoning switch to ", pending_map->map_dir, ".");
+		finish_staging(*pending_map);
+		release_staging(*pending_map);
+		pending_map.reset();
+	}
+	if (tile_cache_ready)
+		TileCache::deinit();
+	tile_cache_ready = use_tile_cache = false;
+	Resources::untrack(Resources::BUFFER, vbo);
 	glDeleteBuffers(1, &vbo);
+	vbo_size = 0;
+	Resources::untrack(Resources::VERTEX_ARRAY, vao);
 	glDeleteVertexArrays(1, &vao);
-	for (int idx = 0; idx < ASSET_COUNT; ++idx)
+	for (int idx = 0; idx < ASSET_COUNT; ++idx) {
+		Resources::untrack(Resources::TEXTURE, textures[idx].id);
 		glDeleteTextures(1, &textures[idx].id);
+		textures[idx].id = 0;
+		textures[idx].internal_format = 0;
+		textures[idx].dims = { 0, 0 };
+	}
+	Resources::untrack(Resources::PROGRAM, program);
 	glDeleteProgram(program);
+	Resources::untrack(Resources::PROGRAM, view_program);
+	glDeleteProgram(view_program);
+
+	if (Resources::check_leaks())
+		Resources::log_summary();
 
 	logger("Successfully deinitialised graphics.");
 }
 
-void Graphics::render(const Camera *camera) {
+bool Graphics::switch_map(const char *dir) {
+	if (pending_map) {
+		logger("Already switching to ", pending_map->map_dir, ", ignoring ", dir, ".");
+		return false;
+	}
+	logger("Switching from ", map_dir, " to ", dir, ".");
+	pending_map = start_staging(dir);
+	return true;
+}
+
+// Commits the pending map once every asset has been staged, between frames so the swap is never partially visible.
+static void poll_map_switch(void) {
+	if (!pending_map || !staging_ready(*pending_map)) return;
+	std::unique_ptr<StagedMap> staged = std::move(pending_map);
+	if (!finish_staging(*staged)) {
+		logger("Failed to load map from ", staged->map_dir, ", keeping ", map_dir, ".");
+		release_staging(*staged);
+		return;
+	}
+	map_clock::time_point staging_finished = staged->started;
+	for (const auto &tex : staged->textures)
+		staging_finished = std::max(staging_finished, tex.finished);
+	const map_clock::time_point commit_started = map_clock::now();
+	const int reused = commit_map(*staged);
+	glFinish();
+	const map_clock::time_point commit_finished = map_clock::now();
+	typedef std::chrono::duration<double, std::milli> ms_t;
+	logger("Switched to ", map_dir, " in ", ms_t(commit_finished - staged->started).count(), " ms: staging took ",
+		ms_t(staging_finished - staged->started).count(), " ms in the background, committing took ",
+		ms_t(commit_finished - commit_started).count(), " ms on the render thread (", reused, "/", ASSET_COUNT, " textures reused",
+		staged->grid.lods[0].firsts.empty() ? ", grid reused" : "", ").");
+}
+
+static void delete_view_target(Graphics::View &view) {
+	Resources::untrack(Resources::TEXTURE, view.colour_tex);
+	glDeleteTextures(1, &view.colour_tex);
+	view.colour_tex = 0;
+	Resources::untrack(Resources::RENDERBUFFER, view.depth_rb);
+	glDeleteRenderbuffers(1, &view.depth_rb);
+	view.depth_rb = 0;
+}
+
+void Graphics::init_view(View &view, const Camera *camera, Projection projection, int lod, int update_interval) {
+	view = {};
+	view.camera = camera;
+	view.projection = projection;
+	view.lod = glm::clamp(lod, 0, GRID_LOD_COUNT - 1);
+	if (view.lod != lod)
+		logger("View LOD ", lod, " clamped to ", view.lod, ".");
+	view.update_interval = glm::max(update_interval, 1);
+	view.proj = glm::mat4{ 1.0f };
+	view.map_generation = map_generation;
+	glGenQueries(2, view.timer_queries);
+	if (view.update_interval > 1) {
+		glGenFramebuffers(1, &view.framebuffer);
+		Resources::track_object(Resources::FRAMEBUFFER, view.framebuffer, "view");
+	}
+}
+
+void Graphics::deinit_view(View &view) {
+	delete_view_target(view);
+	Resources::untrack(Resources::FRAMEBUFFER, view.framebuffer);
+	glDeleteFramebuffers(1, &view.framebuffer);
+	glDeleteQueries(2, view.timer_queries);
+	view = {};
+}
+
+void Graphics::resize_view(View &view, glm::ivec4 viewport) {
+	const bool resized = viewport.z != view.viewport.z || viewport.w != view.viewport.w;
+	view.viewport = viewport;
+	view.frames_until_update = 0;
+	if (viewport.z <= 0 || viewport.w <= 0) return;
+
+	const float aspect_ratio = (float)viewport.z / (float)viewport.w;
+	if (view.projection == OVERVIEW) {
+		glm::vec2 half_dims{ 0.5f * textures[TERRAIN].aspect_ratio * MAP_SIZE, 0.5f * MAP_SIZE };
+		if (aspect_ratio > half_dims.x / half_dims.y) half_dims.x = half_dims.y * aspect_ratio;
+		else half_dims.y = half_dims.x / aspect_ratio;
+		view.proj = glm::ortho(-half_dims.x, half_dims.x, -half_dims.y, half_dims.y, 0.1f, 100.0f);
+	} else
+		view.proj = glm::perspective(glm::radians(70.0f), aspect_ratio, 0.1f, 100.0f);
+
+	if (!view.framebuffer || (!resized && view.colour_tex)) return;
+	delete_view_target(view);
+	glGenTextures(1, &view.colour_tex);
+	glBindTexture(GL_TEXTURE_2D, view.colour_tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, viewport.z, viewport.w, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	Resources::track_texture(view.colour_tex, "view colour", GL_RGBA8, { viewport.z, viewport.w }, 1);
+	glGenRenderbuffers(1, &view.depth_rb);
+	glBindRenderbuffer(GL_RENDERBUFFER, view.depth_rb);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, viewport.z, viewport.w);
+	Resources::track_renderbuffer(view.depth_rb, "view depth", GL_DEPTH_COMPONENT24, { viewport.z, viewport.w });
+
+	glBindFramebuffer(GL_FRAMEBUFFER, view.framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, view.colour_tex, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, view.depth_rb);
+	const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		logger("View framebuffer incomplete (status 0x", std::hex, status, std::dec, "), drawing the view directly instead.");
+		delete_view_target(view);
+		Resources::untrack(Resources::FRAMEBUFFER, view.framebuffer);
+		glDeleteFramebuffers(1, &view.framebuffer);
+		view.framebuffer = 0;
+	}
+}
+
+// Reads the timer query about to be reused, which was issued two frames ago.
+static void collect_view_timer(Graphics::View &view) {
+	if (view.timer_frame < 2) return;
+	const GLuint query = view.timer_queries[view.timer_frame % 2];
+	GLint available = GL_FALSE;
+	glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) return;
+	GLuint64 elapsed_ns = 0;
+	glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed_ns);
+	view.gpu_ms += (double)elapsed_ns * 1e-6;
+	view.gpu_frames++;
+}
+
+static void draw_map(const Graphics::View &view) {
+	if (!draw_3D && use_tile_cache) {
+		const bool drawn = TileCache::render(view.camera->getMatrix(), view.proj, { view.viewport.z, view.viewport.w });
+		glUseProgram(program);
+		glUniform4f(uniforms.vert.uv_region, 0.0f, 0.0f, 1.0f, 1.0f);
+		if (drawn) return;
+		logger("Tile cache can't bake tiles, the flat map will always be drawn directly.");
+		TileCache::deinit();
+		tile_cache_ready = use_tile_cache = false;
+	}
+	glUniformMatrix4fv(uniforms.vert.proj, 1, GL_FALSE, &view.proj[0][0]);
+	glUniformMatrix4fv(uniforms.vert.view, 1, GL_FALSE, &view.camera->getMatrix()[0][0]);
+	const auto &grid_lod = grid.lods[view.lod];
+	glMultiDrawArrays(GL_TRIANGLE_STRIP, grid_lod.firsts.data(), grid_lod.counts.data(), (GLsizei)grid_lod.firsts.size());
+}
+
+static void composite_view(const Graphics::View &view) {
+	glUseProgram(view_program);
+	glDisable(GL_DEPTH_TEST);
+	glBindTexture(GL_TEXTURE_2D, view.colour_tex);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	glEnable(GL_DEPTH_TEST);
+	glUseProgram(program);
+}
+
+void Graphics::render(View *views, int count) {
+	poll_map_switch();
+	if (tile_cache_ready)
+		TileCache::begin_frame();
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glUniformMatrix4fv(uniforms.vert.proj, 1, GL_FALSE, &proj[0][0]);
-	glUniformMatrix4fv(uniforms.vert.view, 1, GL_FALSE, &camera->getMatrix()[0][0]);
 	glUniform1i(uniforms.vert.draw_3D, draw_3D);
-	for (int y = 0; y < rows; ++y)
-		glDrawArrays(GL_TRIANGLE_STRIP, y * indicies_per_row, indicies_per_row);
+	for (int idx = 0; idx < count; ++idx) {
+		View &view = views[idx];
+		if (view.map_generation != map_generation) {
+			view.map_generation = map_generation;
+			resize_view(view, view.viewport);
+		}
+		if (view.viewport.z <= 0 || view.viewport.w <= 0) continue;
+		collect_view_timer(view);
+		glBeginQuery(GL_TIME_ELAPSED, view.timer_queries[view.timer_frame++ % 2]);
+		if (view.framebuffer) {
+			if (view.frames_until_update-- <= 0) {
+				view.frames_until_update = view.update_interval - 1;
+				glBindFramebuffer(GL_FRAMEBUFFER, view.framebuffer);
+				glViewport(0, 0, view.viewport.z, view.viewport.w);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				draw_map(view);
+				glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			}
+			glViewport(view.viewport.x, view.viewport.y, view.viewport.z, view.viewport.w);
+			composite_view(view);
+		} else {
+			glViewport(view.viewport.x, view.viewport.y, view.viewport.z, view.viewport.w);
+			if (idx) {
+				glEnable(GL_SCISSOR_TEST);
+				glScissor(view.viewport.x, view.viewport.y, view.viewport.z, view.viewport.w);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				glDisable(GL_SCISSOR_TEST);
+			}
+			draw_map(view);
+		}
+		glEndQuery(GL_TIME_ELAPSED);
+	}
 }
 
-void Graphics::resize(glm::ivec2 dims) {
-	glViewport(0, 0, dims.x, dims.y);
-	proj = glm::perspective(glm::radians(70.0f), (float)dims.x / (float)dims.y, 0.1f, 100.0f);
+double Graphics::take_view_gpu_ms(View &view) {
+	const double ms = view.gpu_frames ? view.gpu_ms / (double)view.gpu_frames : 0.0;
+	view.gpu_ms = 0.0;
+	view.gpu_frames = 0;
+	return ms;
 }
 
 void Graphics::togggle_draw_3D(void) {
 	draw_3D = !draw_3D;
 }
+
+void Graphics::toggle_tile_cache(void) {
+	if (!tile_cache_ready) {
+		logger("The tile cache is unavailable.");
+		return;
+	}
+	use_tile_cache = !use_tile_cache;
+	logger("Flat map tile cache ", use_tile_cache ? "enabled." : "disabled.");
+}
@@ -2,10 +2,64 @@
 
 #include "Camera.hpp"
 
+#include <GL/glew.h>
+
+#include <vector>
+
 namespace Graphics {
-	bool init(void);
+	enum Projection : int {
+		PERSPECTIVE, // 70 degree field of view
+		OVERVIEW     // Orthographic, fitting the whole map into the viewport
+	};
+	// A camera (not owned), viewport and render target drawn over the shared map textures, program and grid.
+	// Views with update_interval > 1 are drawn into their own texture every update_interval frames,
+	// which is composited into their viewport every frame.
+	struct View {
+		const Camera *camera;
+		Projection projection;
+		int lod, update_interval;
+		glm::ivec4 viewport;
+		glm::mat4 proj;
+		GLuint framebuffer, colour_tex, depth_rb, timer_queries[2];
+		int frames_until_update;
+		uint64_t timer_frame, gpu_frames, map_generation;
+		double gpu_ms;
+	};
+
+	// Every LOD is stored in the same buffer, with GRID_LOD_FACTOR times fewer tiles along each axis than the previous.
+	const int GRID_LOD_COUNT = 3, GRID_LOD_FACTOR = 4;
+	struct Grid {
+		std::vector<glm::vec2> verticies;
+		// One triangle strip per row of tiles.
+		struct {
+			std::vector<GLint> firsts;
+			std::vector<GLsizei> counts;
+		} lods[GRID_LOD_COUNT];
+		// A unit quad for drawing regions of the flat map, kept at the start of the buffer so it survives map switches.
+		GLint quad_first;
+	};
+
+	// Loads the map in map_dir, decoding its assets in parallel.
+	bool init(const char *map_dir);
 	void deinit(void);
-	void render(const Camera *camera);
-	void resize(glm::ivec2 dims);
+	// Starts decoding the map in map_dir in the background; it replaces the current map between frames once ready,
+	// reusing GPU storage where the dims match. Returns false if a switch is already in progress.
+	bool switch_map(const char *map_dir);
+	// lod selects the grid density, each level having a quarter of the tiles along each axis of the one before.
+	void init_view(View &view, const Camera *camera, Projection projection, int lod, int update_interval);
+	void deinit_view(View &view);
+	// viewport is x, y, width, height in framebuffer pixels.
+	void resize_view(View &view, glm::ivec4 viewport);
+	// The first view is drawn underneath the rest.
+	void render(View *views, int count);
+	// Average GPU time per frame spent on the view since the last call.
+	double take_view_gpu_ms(View &view);
 	void togggle_draw_3D(void);
+	// Toggles compositing cached tiles instead of shading every pixel when the map is drawn flat.
+	void toggle_tile_cache(void);
+
+	// Fills verticies (2 * (tile_count.x + 1) * tile_count.y of them) with one triangle strip per row of tiles.
+	void generate_grid(glm::ivec2 tile_count, glm::vec2 *verticies);
+	// Builds the quad and every LOD of the grid for a terrain of terrain_dims pixels, without touching GL.
+	void build_grid(glm::ivec2 terrain_dims, Grid &grid);
 }
@@ -13,8 +13,55 @@
 	#include <glm/gtx/string_cast.hpp>
 #endif
 
-int main(void) {
-	if (!Window::init(1920, 1080, "sphere-map")) {
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define DEFAULT_MAP_DIR R"(C:\Program Files (x86)\Steam\steamapps\common\Victoria 2\map)"
+#define DEFAULT_CONFIG "map-engine.cfg"
+
+// Reads "map_dir=<path>" lines, ignoring blank lines and lines starting with '#'.
+static bool read_config(const char *filepath, std::vector<std::string> &map_dirs) {
+	std::ifstream file{ filepath };
+	if (!file) return false;
+	const std::string key = "map_dir=";
+	std::string line;
+	for (int line_num = 1; std::getline(file, line); ++line_num) {
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+		if (line.empty() || line[0] == '#') continue;
+		if (line.compare(0, key.size(), key) == 0 && line.size() > key.size())
+			map_dirs.push_back(line.substr(key.size()));
+		else
+			logger("Ignoring line ", line_num, " of ", filepath, ": ", line);
+	}
+	return true;
+}
+
+// Usage: map-engine [--config FILE] [MAP_DIR...]
+// Map directories on the command line take precedence over the config file, the first one is loaded
+// and N cycles through the rest.
+int main(int argc, char **argv) {
+	const char *config_path = nullptr;
+	std::vector<std::string> map_dirs;
+	for (int idx = 1; idx < argc; ++idx) {
+		const std::string arg = argv[idx];
+		if (arg == "--config" && idx + 1 < argc) config_path = argv[++idx];
+		else if (arg.compare(0, 2, "--") == 0) {
+			if (arg != "--help") logger("Unknown option or missing value: ", arg);
+			std::cout << "Usage: " << argv[0] << " [--config FILE] [MAP_DIR...]" << std::endl;
+			return arg == "--help" ? 0 : -1;
+		} else map_dirs.push_back(arg);
+	}
+	if (map_dirs.empty()) {
+		if (!read_config(config_path ? config_path : DEFAULT_CONFIG, map_dirs) && config_path) {
+			logger("Failed to read config ", config_path);
+			return -1;
+		}
+		if (map_dirs.empty()) map_dirs.push_back(DEFAULT_MAP_DIR);
+	}
+
+	if (!Window::init(1920, 1080, "sphere-map", map_dirs)) {
 		logger("Window initialisation failed.");
 		return -1;
 	}
@@ -0,0 +1,157 @@
+#include "Resources.hpp"
+
+#include "Logger.hpp"
+
+#include <map>
+#include <mutex>
+#include <string>
+
+struct Entry {
+	std::string name;
+	GLenum format;
+	glm::ivec2 dims;
+	GLint mip_levels;
+	size_t bytes;
+};
+typedef std::pair<Resources::Type, uintptr_t> entry_key_t;
+
+static std::mutex resources_mutex;
+static std::map<entry_key_t, Entry> entries;
+static Resources::Usage usage;
+
+static const char *type_name(Resources::Type type) {
+	switch (type) {
+#define F(X) case Resources::X: return #X;
+		F(TEXTURE) F(BUFFER) F(RENDERBUFFER) F(VERTEX_ARRAY) F(PROGRAM) F(FRAMEBUFFER) F(CPU_STAGING)
+#undef F
+	default: return "UNKNOWN";
+	}
+}
+static bool is_gpu(Resources::Type type) {
+	return type != Resources::CPU_STAGING;
+}
+static double to_mib(size_t bytes) {
+	return (double)bytes / (1024.0 * 1024.0);
+}
+
+// Returns 0 for unknown formats, and for block compressed formats the size of a 4x4 block.
+static size_t format_bytes(GLenum format, bool &block_compressed) {
+	block_compressed = false;
+	switch (format) {
+	case GL_R8: case GL_RED: return 1;
+	case GL_RG8: case GL_RG: case GL_R16F: return 2;
+	case GL_RGB8: case GL_RGB: case GL_SRGB8: return 3;
+	case GL_RGBA8: case GL_RGBA: case GL_SRGB8_ALPHA8: case GL_R32F: case GL_RG16F:
+	case GL_DEPTH_COMPONENT24: case GL_DEPTH24_STENCIL8: return 4;
+	case GL_RGBA16F: case GL_RG32F: return 8;
+	case GL_RGBA32F: return 16;
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+		block_compressed = true;
+		return 8;
+	case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT: case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		block_compressed = true;
+		return 16;
+	default: return 0;
+	}
+}
+static size_t texture_bytes(GLenum format, glm::ivec2 dims, GLint mip_levels) {
+	bool block_compressed;
+	const size_t unit = format_bytes(format, block_compressed);
+	if (!unit)
+		logger("Unknown texture format 0x", std::hex, format, std::dec, ", assuming 4 bytes per texel.");
+	size_t total = 0;
+	for (GLint level = 0; level < mip_levels; ++level) {
+		const size_t w = glm::max(dims.x >> level, 1), h = glm::max(dims.y >> level, 1);
+		if (block_compressed) total += ((w + 3) / 4) * ((h + 3) / 4) * unit;
+		else total += w * h * (unit ? unit : 4);
+	}
+	return total;
+}
+
+static void add_entry(Resources::Type type, uintptr_t id, Entry &&entry) {
+	std::lock_guard<std::mutex> guard{ resources_mutex };
+	const entry_key_t key{ type, id };
+	const auto it = entries.find(key);
+	if (it != entries.end()) {
+		logger(type_name(type), " ", id, " (", it->second.name, ") is already tracked, replacing with ", entry.name, ".");
+		usage.count[type]--;
+		usage.bytes[type] -= it->second.bytes;
+		(is_gpu(type) ? usage.gpu_bytes : usage.cpu_bytes) -= it->second.bytes;
+		entries.erase(it);
+	}
+	usage.count[type]++;
+	usage.bytes[type] += entry.bytes;
+	if (is_gpu(type)) {
+		usage.gpu_bytes += entry.bytes;
+		usage.gpu_peak = glm::max(usage.gpu_peak, usage.gpu_bytes);
+	} else {
+		usage.cpu_bytes += entry.bytes;
+		usage.cpu_peak = glm::max(usage.cpu_peak, usage.cpu_bytes);
+	}
+	entries.emplace(key, std::move(entry));
+}
+static void remove_entry(Resources::Type type, uintptr_t id) {
+	if (!id) return;
+	std::lock_guard<std::mutex> guard{ resources_mutex };
+	const auto it = entries.find({ type, id });
+	if (it == entries.end()) {
+		logger("Untracking unknown ", type_name(type), " ", id, ".");
+		return;
+	}
+	usage.count[type]--;
+	usage.bytes[type] -= it->second.bytes;
+	(is_gpu(type) ? usage.gpu_bytes : usage.cpu_bytes) -= it->second.bytes;
+	entries.erase(it);
+}
+
+void Resources::track_texture(GLuint id, const char *name, GLenum internal_format, glm::ivec2 dims, GLint mip_levels) {
+	add_entry(TEXTURE, id, { name, internal_format, dims, mip_levels, texture_bytes(internal_format, dims, mip_levels) });
+}
+void Resources::track_buffer(GLuint id, const char *name, size_t bytes) {
+	add_entry(BUFFER, id, { name, 0, { (int)bytes, 1 }, 1, bytes });
+}
+void Resources::track_renderbuffer(GLuint id, const char *name, GLenum internal_format, glm::ivec2 dims) {
+	add_entry(RENDERBUFFER, id, { name, internal_format, dims, 1, texture_bytes(internal_format, dims, 1) });
+}
+void Resources::track_object(Type type, GLuint id, const char *name) {
+	add_entry(type, id, { name, 0, { 0, 0 }, 0, 0 });
+}
+void Resources::untrack(Type type, GLuint id) {
+	remove_entry(type, id);
+}
+void Resources::track_cpu(const void *ptr, const char *name, size_t bytes) {
+	add_entry(CPU_STAGING, (uintptr_t)ptr, { name, 0, { (int)bytes, 1 }, 1, bytes });
+}
+void Resources::untrack_cpu(const void *ptr) {
+	remove_entry(CPU_STAGING, (uintptr_t)ptr);
+}
+
+Resources::Usage Resources::get_usage(void) {
+	std::lock_guard<std::mutex> guard{ resources_mutex };
+	return usage;
+}
+
+void Resources::log_summary(void) {
+	std::lock_guard<std::mutex> guard{ resources_mutex };
+	logger("GPU: ", to_mib(usage.gpu_bytes), " MiB (peak ", to_mib(usage.gpu_peak), " MiB), CPU staging: ",
+		to_mib(usage.cpu_bytes), " MiB (peak ", to_mib(usage.cpu_peak), " MiB).");
+	for (int type = 0; type < TYPE_COUNT; ++type)
+		if (usage.count[type])
+			logger("  ", type_name((Type)type), ": ", usage.count[type], " using ", to_mib(usage.bytes[type]), " MiB");
+	for (const auto &[key, entry] : entries) {
+		if (key.first == TEXTURE || key.first == RENDERBUFFER)
+			logger("  ", type_name(key.first), " ", key.second, " ", entry.name, ": ", entry.dims.x, " x ", entry.dims.y,
+				", format 0x", std::hex, entry.format, std::dec, ", ", entry.mip_levels, " mip level(s), ", entry.bytes, " bytes");
+		else
+			logger("  ", type_name(key.first), " ", key.second, " ", entry.name, ": ", entry.bytes, " bytes");
+	}
+}
+
+size_t Resources::check_leaks(void) {
+	std::lock_guard<std::mutex> guard{ resources_mutex };
+	for (const auto &[key, entry] : entries)
+		logger("Leaked ", type_name(key.first), " ", key.second, " (", entry.name, ", ", entry.bytes, " bytes).");
+	if (entries.empty())
+		logger("No leaked resources (peak GPU ", to_mib(usage.gpu_peak), " MiB, peak CPU staging ", to_mib(usage.cpu_peak), " MiB).");
+	return entries.size();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+namespace Resources {
+	enum Type : int {
+		TEXTURE, BUFFER, RENDERBUFFER, VERTEX_ARRAY, PROGRAM, FRAMEBUFFER, CPU_STAGING, TYPE_COUNT
+	};
+	struct Usage {
+		size_t count[TYPE_COUNT], bytes[TYPE_COUNT];
+		size_t gpu_bytes, gpu_peak, cpu_bytes, cpu_peak;
+	};
+
+	void track_texture(GLuint id, const char *name, GLenum internal_format, glm::ivec2 dims, GLint mip_levels);
+	void track_buffer(GLuint id, const char *name, size_t bytes);
+	void track_renderbuffer(GLuint id, const char *name, GLenum internal_format, glm::ivec2 dims);
+	// For GL objects without meaningful storage of their own (VAOs, programs, framebuffers).
+	void track_object(Type type, GLuint id, const char *name);
+	void untrack(Type type, GLuint id);
+	void track_cpu(const void *ptr, const char *name, size_t bytes);
+	void untrack_cpu(const void *ptr);
+
+	Usage get_usage(void);
+	void log_summary(void);
+	// Logs every resource still tracked and returns how many there are.
+	size_t check_leaks(void);
+}
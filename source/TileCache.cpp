@@ -0,0 +1,293 @@
+#include "TileCache.hpp"
+
+#include "Logger.hpp"
+#include "GLTools.hpp"
+#include "Resources.hpp"
+
+#include <iterator>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "map_vert.glsl"
+#include "tile_frag.glsl"
+
+const GLsizei TILE_RES = 256;
+const GLint TILE_MIP_LEVELS = 9;
+// Tiles covering more than TILE_RES * SUBDIVIDE_RATIO pixels on screen are split into their 4 children, while those at
+// MAX_LEVEL covering more than TILE_RES * DIRECT_RATIO pixels are drawn directly rather than magnified.
+const float SUBDIVIDE_RATIO = 1.0f, DIRECT_RATIO = 2.0f;
+const int MAX_LEVEL = 6, MAX_BAKES_PER_FRAME = 16;
+const uint64_t INVALID_KEY = ~0ull;
+
+struct Tile {
+	uint64_t key, last_used;
+	GLuint tex;
+};
+struct Selected {
+	glm::vec4 uv_region;
+	uint64_t key;
+	GLuint tex;
+	bool direct;
+};
+
+static GLuint program, framebuffer;
+// Completeness is checked on the first bake, once a tile is attached.
+static bool framebuffer_checked;
+static struct {
+	GLint model, view, proj, uv_region, draw_3D, tile_tex;
+} uniforms;
+static TileCache::draw_region_func_t draw_region;
+static GLint quad_first;
+static size_t capacity;
+
+static glm::mat4 model, model_inverse;
+static glm::ivec2 root_tiles{ 1, 1 };
+
+// Most recently used at the front.
+static std::list<Tile> tiles;
+static std::unordered_map<uint64_t, std::list<Tile>::iterator> tile_lookup;
+static std::vector<Selected> selected;
+static std::vector<Tile *> to_bake;
+static uint64_t frame;
+static int frame_bakes;
+static struct {
+	uint64_t hits, bakes, direct, evictions;
+} stats;
+
+static uint64_t tile_key(int level, int x, int y) {
+	return (uint64_t)level << 48 | (uint64_t)x << 24 | (uint64_t)y;
+}
+static glm::vec4 tile_region(int level, int x, int y) {
+	const glm::vec2 size{ 1.0f / (float)(root_tiles.x << level), 1.0f / (float)(root_tiles.y << level) };
+	return { (float)x * size.x, (float)y * size.y, size.x, size.y };
+}
+
+bool TileCache::init(size_t budget_bytes, draw_region_func_t draw_region_func, GLint quad_first_vertex, GLint texture_unit) {
+	// 4/3 for the mip chain
+	capacity = budget_bytes / (TILE_RES * TILE_RES * 4 * 4 / 3);
+	if (!capacity) {
+		logger("Tile cache budget of ", budget_bytes, " bytes is too small for a single tile.");
+		return false;
+	}
+	if (load_program(program, SHADER_VERT, nullptr, SHADER_TILE_FRAG)) {
+		logger("Failed to load tile shaders.");
+		return false;
+	}
+	uniforms.model = glGetUniformLocation(program, "model");
+	uniforms.view = glGetUniformLocation(program, "view");
+	uniforms.proj = glGetUniformLocation(program, "proj");
+	uniforms.uv_region = glGetUniformLocation(program, "uv_region");
+	uniforms.draw_3D = glGetUniformLocation(program, "draw_3D");
+	uniforms.tile_tex = glGetUniformLocation(program, "tile_tex");
+	glUseProgram(program);
+	glUniform1i(uniforms.draw_3D, false);
+	glUniform1i(uniforms.tile_tex, texture_unit);
+
+	glGenFramebuffers(1, &framebuffer);
+	Resources::track_object(Resources::FRAMEBUFFER, framebuffer, "tile bake");
+	framebuffer_checked = false;
+	draw_region = draw_region_func;
+	quad_first = quad_first_vertex;
+	frame = 0;
+	frame_bakes = 0;
+	stats = {};
+	logger("Tile cache holds up to ", capacity, " tiles of ", TILE_RES, " x ", TILE_RES, ".");
+	return true;
+}
+
+void TileCache::deinit(void) {
+	for (Tile &tile : tiles) {
+		Resources::untrack(Resources::TEXTURE, tile.tex);
+		glDeleteTextures(1, &tile.tex);
+	}
+	tiles.clear();
+	tile_lookup.clear();
+	Resources::untrack(Resources::FRAMEBUFFER, framebuffer);
+	glDeleteFramebuffers(1, &framebuffer);
+	framebuffer = 0;
+	Resources::untrack(Resources::PROGRAM, program);
+	glDeleteProgram(program);
+	program = 0;
+}
+
+void TileCache::set_map(const glm::mat4 &map_model, float aspect_ratio) {
+	model = map_model;
+	model_inverse = glm::inverse(model);
+	// Roughly square tiles in world space
+	root_tiles = aspect_ratio >= 1.0f ? glm::ivec2{ glm::max((int)(aspect_ratio + 0.5f), 1), 1 }
+		: glm::ivec2{ 1, glm::max((int)(1.0f / aspect_ratio + 0.5f), 1) };
+	glUseProgram(program);
+	glUniformMatrix4fv(uniforms.model, 1, GL_FALSE, &model[0][0]);
+	invalidate();
+}
+
+// Keeps the textures for reuse, only forgetting what they hold.
+void TileCache::invalidate(void) {
+	for (Tile &tile : tiles) {
+		tile.key = INVALID_KEY;
+		tile.last_used = 0;
+	}
+	tile_lookup.clear();
+}
+
+static void select_tiles(const glm::mat4 &mvp, glm::vec2 half_viewport, int level, int x, int y) {
+	const glm::vec4 region = tile_region(level, x, y);
+	glm::vec4 clip[4];
+	for (int c = 0; c < 4; ++c)
+		clip[c] = mvp * glm::vec4{ region.x + (float)(c & 1) * region.z, 0.0f, region.y + (float)(c >> 1) * region.w, 1.0f };
+	// Cull if every corner is outside the same clip plane
+	for (int axis = 0; axis < 3; ++axis) {
+		int below = 0, above = 0;
+		for (const glm::vec4 &corner : clip) {
+			below += corner[axis] < -corner.w;
+			above += corner[axis] > corner.w;
+		}
+		if (below == 4 || above == 4) return;
+	}
+	bool behind = false;
+	glm::vec2 min_pos{ 0.0f }, max_pos{ 0.0f };
+	for (int c = 0; c < 4; ++c) {
+		if (clip[c].w <= 0.0f) {
+			behind = true;
+			break;
+		}
+		const glm::vec2 pos = glm::vec2{ clip[c].x, clip[c].y } / clip[c].w * half_viewport;
+		min_pos = c ? glm::min(min_pos, pos) : pos;
+		max_pos = c ? glm::max(max_pos, pos) : pos;
+	}
+	const float size = glm::max(max_pos.x - min_pos.x, max_pos.y - min_pos.y);
+	if ((behind || size > TILE_RES * SUBDIVIDE_RATIO) && level < MAX_LEVEL) {
+		for (int child = 0; child < 4; ++child)
+			select_tiles(mvp, half_viewport, level + 1, 2 * x + (child & 1), 2 * y + (child >> 1));
+		return;
+	}
+	selected.push_back({ region, tile_key(level, x, y), 0, behind || size > TILE_RES * DIRECT_RATIO });
+}
+
+// Returns a tile to bake into, or nullptr if every tile was already used this frame (by any view).
+static Tile *acquire_tile(uint64_t key) {
+	if (tiles.size() < capacity) {
+		Tile tile{ key, frame, 0 };
+		glGenTextures(1, &tile.tex);
+		glBindTexture(GL_TEXTURE_2D, tile.tex);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, TILE_RES, TILE_RES, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		Resources::track_texture(tile.tex, "map tile", GL_RGBA8, { TILE_RES, TILE_RES }, TILE_MIP_LEVELS);
+		tiles.push_front(tile);
+	} else {
+		if (tiles.back().last_used == frame) return nullptr;
+		if (tiles.back().key != INVALID_KEY) {
+			tile_lookup.erase(tiles.back().key);
+			stats.evictions++;
+		}
+		tiles.splice(tiles.begin(), tiles, std::prev(tiles.end()));
+		tiles.front().key = key;
+		tiles.front().last_used = frame;
+	}
+	tile_lookup[key] = tiles.begin();
+	return &tiles.front();
+}
+
+static bool bake_tiles(void) {
+	GLint previous_framebuffer = 0, previous_viewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_framebuffer);
+	glGetIntegerv(GL_VIEWPORT, previous_viewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, TILE_RES, TILE_RES);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+	bool complete = true;
+	for (Tile *tile : to_bake) {
+		const glm::vec4 region = tile_region((int)(tile->key >> 48), (int)(tile->key >> 24 & 0xFFFFFF), (int)(tile->key & 0xFFFFFF));
+		// Maps the tile's region of (u, height, v) model space onto clip space
+		glm::mat4 proj{ 0.0f };
+		proj[0][0] = 2.0f / region.z;
+		proj[2][1] = 2.0f / region.w;
+		proj[3] = { -2.0f * region.x / region.z - 1.0f, -2.0f * region.y / region.w - 1.0f, 0.0f, 1.0f };
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tile->tex, 0);
+		if (!framebuffer_checked) {
+			const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+			if (status != GL_FRAMEBUFFER_COMPLETE) {
+				logger("Tile bake framebuffer incomplete (status 0x", std::hex, status, std::dec, ").");
+				complete = false;
+				break;
+			}
+			framebuffer_checked = true;
+		}
+		draw_region(region, model_inverse, proj);
+		glBindTexture(GL_TEXTURE_2D, tile->tex);
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+	glEnable(GL_CULL_FACE);
+	glEnable(GL_DEPTH_TEST);
+	glBindFramebuffer(GL_FRAMEBUFFER, previous_framebuffer);
+	glViewport(previous_viewport[0], previous_viewport[1], previous_viewport[2], previous_viewport[3]);
+	if (complete) stats.bakes += to_bake.size();
+	return complete;
+}
+
+void TileCache::begin_frame(void) {
+	frame++;
+	frame_bakes = 0;
+}
+
+bool TileCache::render(const glm::mat4 &view, const glm::mat4 &proj, glm::ivec2 viewport_dims) {
+	selected.clear();
+	const glm::mat4 mvp = proj * view * model;
+	for (int y = 0; y < root_tiles.y; ++y)
+		for (int x = 0; x < root_tiles.x; ++x)
+			select_tiles(mvp, 0.5f * glm::vec2{ viewport_dims }, 0, x, y);
+
+	to_bake.clear();
+	for (Selected &tile : selected) {
+		if (tile.direct) continue;
+		const auto it = tile_lookup.find(tile.key);
+		if (it != tile_lookup.end()) {
+			tiles.splice(tiles.begin(), tiles, it->second);
+			it->second->last_used = frame;
+			tile.tex = it->second->tex;
+			stats.hits++;
+			continue;
+		}
+		Tile *baked = frame_bakes + (int)to_bake.size() < MAX_BAKES_PER_FRAME ? acquire_tile(tile.key) : nullptr;
+		if (baked) {
+			to_bake.push_back(baked);
+			tile.tex = baked->tex;
+		} else
+			tile.direct = true;
+	}
+	if (!to_bake.empty() && !bake_tiles()) {
+		// The tiles just acquired hold nothing
+		invalidate();
+		return false;
+	}
+	frame_bakes += (int)to_bake.size();
+
+	glUseProgram(program);
+	glUniformMatrix4fv(uniforms.view, 1, GL_FALSE, &view[0][0]);
+	glUniformMatrix4fv(uniforms.proj, 1, GL_FALSE, &proj[0][0]);
+	for (const Selected &tile : selected) {
+		if (tile.direct) continue;
+		glUniform4fv(uniforms.uv_region, 1, &tile.uv_region[0]);
+		glBindTexture(GL_TEXTURE_2D, tile.tex);
+		glDrawArrays(GL_TRIANGLE_STRIP, quad_first, 4);
+	}
+	for (const Selected &tile : selected) {
+		if (!tile.direct) continue;
+		draw_region(tile.uv_region, view, proj);
+		stats.direct++;
+	}
+	return true;
+}
+
+void TileCache::log_stats(void) {
+	if (!stats.hits && !stats.bakes && !stats.direct) return;
+	logger("Tile cache: ", tile_lookup.size(), "/", capacity, " tiles cached, ", stats.hits, " hits, ", stats.bakes,
+		" bakes, ", stats.direct, " drawn directly, ", stats.evictions, " evictions.");
+	stats = {};
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+// Cached renders of the flat (2D) map: a quadtree of TILE_RES x TILE_RES tiles over the map's uv space, baked with
+// the full map shader on first use and composited afterwards. Tiles are kept in an LRU with a fixed byte budget.
+namespace TileCache {
+	// Draws uv_region (xy offset, zw size) of the flat map with the full map shader and the given matrices.
+	typedef void (*draw_region_func_t)(glm::vec4 uv_region, const glm::mat4 &view, const glm::mat4 &proj);
+
+	// quad_first is the first of 4 triangle strip verticies (0,0), (0,1), (1,0), (1,1) in the bound vertex array,
+	// texture_unit is the (active) unit tiles are bound on while compositing.
+	bool init(size_t budget_bytes, draw_region_func_t draw_region, GLint quad_first, GLint texture_unit);
+	void deinit(void);
+	// Sets the map's model matrix and aspect ratio (which determines the number of root tiles), invalidating all tiles.
+	void set_map(const glm::mat4 &model, float aspect_ratio);
+	// Must be called whenever anything affecting the map's flat shading changes.
+	void invalidate(void);
+	// Must be called once per frame before any render, as the bake limit and LRU protection span every view in a frame.
+	void begin_frame(void);
+	// Draws the flat map, baking at most a few missing tiles per call and drawing the rest directly.
+	// The map program must be rebound afterwards. Returns false without drawing if tiles can't be baked
+	// (incomplete framebuffer), in which case the cache should be deinitialised and the map drawn directly.
+	bool render(const glm::mat4 &view, const glm::mat4 &proj, glm::ivec2 viewport_dims);
+	// Logs hit, bake and eviction counts since the last call, if any tiles were drawn.
+	void log_stats(void);
+}
@@ -2,12 +2,14 @@
 
 #include "Logger.hpp"
 #include "Graphics.hpp"
+#include "TileCache.hpp"
 
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
 #include <thread>
 #include <mutex>
+#include <string>
 #include <vector>
 
 static volatile bool loop_run_flag = false;
@@ -26,6 +28,18 @@ static struct {
 } window;
 
 static CameraRot camera;
+static CameraTopDown overview_camera;
+
+enum Views : int {
+	MAIN_VIEW, MINIMAP_VIEW, VIEW_COUNT
+};
+static Graphics::View views[VIEW_COUNT];
+static bool show_minimap = true;
+const int MINIMAP_LOD = 2, MINIMAP_UPDATE_INTERVAL = 4, MINIMAP_MARGIN = 16;
+static std::vector<std::string> map_dirs;
+static size_t map_dir_idx = 0;
+// Seconds between logs of the GPU time spent on each view.
+const uint64_t VIEW_TIMING_PERIOD = 10;
 
 static void error_callback(int err, const char *desc) {
 	logger("GLFW error ", err, ": ", desc, ".");
@@ -54,11 +68,17 @@ static void cursor_position_callback(GLFWwindow *window_ptr, double xpos, double
 	}
 }
 
-bool Window::init(int width, int height, const char *title) {
+bool Window::init(int width, int height, const char *title, const std::vector<std::string> &dirs) {
 	if (window.glfw_ptr) {
 		logger("Window has already been initialised.");
 		return false;
 	}
+	if (dirs.empty()) {
+		logger("No map directories given.");
+		return false;
+	}
+	map_dirs = dirs;
+	map_dir_idx = 0;
 	glfwSetErrorCallback(error_callback);
 	if (!glfwInit()) {
 		logger("Failed to initialise GLFW.");
@@ -86,7 +106,7 @@ bool Window::init(int width, int height, const char *title) {
 
 	logger("Successfully initialised GLFW.");
 
-	if (!Graphics::init()) {
+	if (!Graphics::init(map_dirs[map_dir_idx].c_str())) {
 		logger("Failed to initialize graphics.");
 		glfwDestroyWindow(window.glfw_ptr);
 		window.glfw_ptr = nullptr;
@@ -94,6 +114,9 @@ bool Window::init(int width, int height, const char *title) {
 		return false;
 	}
 
+	Graphics::init_view(views[MAIN_VIEW], &camera, Graphics::PERSPECTIVE, 0, 1);
+	Graphics::init_view(views[MINIMAP_VIEW], &overview_camera, Graphics::OVERVIEW, MINIMAP_LOD, MINIMAP_UPDATE_INTERVAL);
+
 	window.dims = { width, height };
 	window.resized = true;
 
@@ -105,6 +128,8 @@ void Window::deinit(void) {
 		logger("Window has not been initialised.");
 		return;
 	}
+	for (Graphics::View &view : views)
+		Graphics::deinit_view(view);
 	Graphics::deinit();
 	glfwDestroyWindow(window.glfw_ptr);
 	window.glfw_ptr = nullptr;
@@ -112,6 +137,12 @@ void Window::deinit(void) {
 	logger("Successfully deinitialised GLFW.");
 }
 
+static void resize_views(glm::ivec2 dims) {
+	Graphics::resize_view(views[MAIN_VIEW], { 0, 0, dims.x, dims.y });
+	const glm::ivec2 minimap_dims{ dims.x / 4, dims.y / 4 };
+	Graphics::resize_view(views[MINIMAP_VIEW], { dims.x - minimap_dims.x - MINIMAP_MARGIN, MINIMAP_MARGIN, minimap_dims.x, minimap_dims.y });
+}
+
 const uint64_t TARGET_TPS = 60;
 const double TARGET_SPT = 1.0 / double(TARGET_TPS);
 
@@ -120,7 +151,7 @@ static void loop_function(void) {
 	glfwMakeContextCurrent(window.glfw_ptr);
 
 	double last_second = glfwGetTime(), last_loop = last_second, tick_time_passed = 0.0;
-	uint64_t frame_count = 0, tick_count = 0, fps_display = 0, tps_display = 0;
+	uint64_t frame_count = 0, tick_count = 0, fps_display = 0, tps_display = 0, second_count = 0;
 
 	while (loop_run_flag) {
 		const double current_time = glfwGetTime();
@@ -135,7 +166,7 @@ static void loop_function(void) {
 				{
 					std::lock_guard<std::mutex> guard{ input_mutex };
 					if (window.resized) {
-						Graphics::resize(window.dims);
+						resize_views(window.dims);
 						window.resized = false;
 					}
 					static bool key_w = false, key_s = false, key_a = false, key_d = false,
@@ -154,6 +185,13 @@ static void loop_function(void) {
 						case GLFW_KEY_LEFT_SHIFT: key_left_shift = e.action != GLFW_RELEASE; break;
 						case GLFW_KEY_LEFT_CONTROL: key_left_control = e.action != GLFW_RELEASE; break;
 						case GLFW_KEY_T: if (e.action == GLFW_PRESS) Graphics::togggle_draw_3D(); break;
+						case GLFW_KEY_I: if (e.action == GLFW_PRESS) Graphics::toggle_tile_cache(); break;
+						case GLFW_KEY_M: if (e.action == GLFW_PRESS) show_minimap = !show_minimap; break;
+						case GLFW_KEY_N:
+							if (e.action == GLFW_PRESS && map_dirs.size() > 1
+								&& Graphics::switch_map(map_dirs[(map_dir_idx + 1) % map_dirs.size()].c_str()))
+								map_dir_idx = (map_dir_idx + 1) % map_dirs.size();
+							break;
 						}
 					}
 					window.key_events.clear();
@@ -177,7 +215,7 @@ static void loop_function(void) {
 			// Frame
 			frame_count++;
 
-			Graphics::render(&camera);
+			Graphics::render(views, show_minimap ? VIEW_COUNT : 1);
 
 			glfwSwapBuffers(window.glfw_ptr);
 		}
@@ -191,6 +229,15 @@ static void loop_function(void) {
 			tick_count = 0;
 			if (fps_display != TARGET_TPS || tps_display != TARGET_TPS)
 				logger("FPS: ", fps_display, ", TPS: ", tps_display);
+			if (++second_count % VIEW_TIMING_PERIOD == 0) {
+				const double main_ms = Graphics::take_view_gpu_ms(views[MAIN_VIEW]);
+				const double minimap_ms = Graphics::take_view_gpu_ms(views[MINIMAP_VIEW]);
+				if (show_minimap)
+					logger("GPU ms/frame: main view ", main_ms, ", minimap ", minimap_ms, " (redrawn every ", MINIMAP_UPDATE_INTERVAL, " frames).");
+				else
+					logger("GPU ms/frame: main view ", main_ms, " (minimap hidden).");
+				TileCache::log_stats();
+			}
 		}
 		last_loop = current_time;
 	}
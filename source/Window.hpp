@@ -1,7 +1,11 @@
 #pragma once
 
+#include <string>
+#include <vector>
+
 namespace Window {
-	bool init(int width, int height, const char *title);
+	// The first of map_dirs is loaded, the rest can be switched to at runtime.
+	bool init(int width, int height, const char *title, const std::vector<std::string> &map_dirs);
 	void deinit(void);
 	void run(void);
 }
@@ -5,9 +5,10 @@ const char *const SHADER_VERT = R"(
 
 layout(location = 0) in vec2 uv_in;
 
-out vec2 uv_frag;
+out vec2 uv_frag, uv_local;
 
 uniform mat4 model, view, proj;
+uniform vec4 uv_region; // xy offset and zw scale applied to uv_in
 uniform sampler2D terrain_tex;
 uniform bool draw_3D;
 
@@ -38,9 +39,11 @@ float get_height(vec2 pos) {
 }
 
 void main(void) {
-	float height = draw_3D ? get_height(uv_in) : 0.0f;
-	gl_Position = proj * view * model * vec4(uv_in.x, height, uv_in.y, 1.0f);
-	uv_frag = uv_in;
+	vec2 uv = uv_region.xy + uv_in * uv_region.zw;
+	float height = draw_3D ? get_height(uv) : 0.0f;
+	gl_Position = proj * view * model * vec4(uv.x, height, uv.y, 1.0f);
+	uv_frag = uv;
+	uv_local = uv_in;
 }
 
 )";
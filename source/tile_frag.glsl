@@ -0,0 +1,16 @@
+
+const char *const SHADER_TILE_FRAG = R"(
+
+#version 330 core
+
+in vec2 uv_local;
+
+out vec4 colour_out;
+
+uniform sampler2D tile_tex;
+
+void main(void) {
+	colour_out = texture(tile_tex, uv_local);
+}
+
+)";
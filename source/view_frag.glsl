@@ -0,0 +1,16 @@
+
+const char *const SHADER_VIEW_FRAG = R"(
+
+#version 330 core
+
+in vec2 uv_frag;
+
+out vec4 colour_out;
+
+uniform sampler2D view_tex;
+
+void main(void) {
+	colour_out = texture(view_tex, uv_frag);
+}
+
+)";
@@ -0,0 +1,14 @@
+
+const char *const SHADER_VIEW_VERT = R"(
+
+#version 330 core
+
+out vec2 uv_frag;
+
+void main(void) {
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+	gl_Position = vec4(corner * 2.0f - 1.0f, 0.0f, 1.0f);
+	uv_frag = corner;
+}
+
+)";